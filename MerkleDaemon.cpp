@@ -0,0 +1,336 @@
+#include<iostream>
+#include<vector>
+#include<string>
+#include<unordered_map>
+#include <cerrno>
+#include <cstring>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "SparseMerkleTree.h"
+#include "MerkleProtocol.h"
+
+using namespace std;
+using namespace CryptoPP;
+
+#define MAX_EVENTS 256
+#define MAX_BATCH 4096
+#define MAX_CONNECTION_BATCH 256//requests one connection can add to a batch, so deep pipelines can not crowd everyone else out
+#define ACCEPT_BACKOFF_MS 100//how long to stop accepting after running out of file descriptors
+#define MAX_BUFFERED 1048576//bytes of unread requests or unsent responses a connection may hold before the daemon stops reading from it
+
+/*Serves a single SparseMerkleTree over a unix domain socket (path given as the only argument, DEFAULT_SOCKET_PATH otherwise) from one epoll loop.
+Every pass of the loop takes all complete requests from every connection as one batch: the inserts go into the tree together through InsertBatch so
+shared ancestors are hashed once, then the reads run against the updated tree with the root fetched once and duplicate proofs built once.
+A client may shut down its write side once it has sent everything, its requests are still answered before the connection is closed.
+Build with: g++ -std=c++14 -O2 MerkleDaemon.cpp SparseMerkleTree.cpp MerkleTree.cpp RBTree.cpp -lcryptopp -o MerkleDaemon*/
+
+struct Connection {
+	int fd;
+	string in;//bytes received but not yet taken into a batch
+	string out;//responses not yet written
+	bool readClosed = false;//the client will not send anything else, close once everything it sent is answered
+	uint32_t events = EPOLLIN;//what epoll is currently watching for
+};
+
+struct Request {
+	Connection* conn;
+	byte op;
+	unsigned int key;
+	const byte* digest;//points into conn->in, which is not touched until the batch is done
+};
+
+void appendResponse(string& out, byte status, const byte payload[], size_t length) {
+	out.push_back((char)status);
+	out.push_back((char)(length >> 8));
+	out.push_back((char)length);
+	out.append((const char*)payload, length);
+}
+
+void closeConnection(int epollFd, unordered_map<int, Connection>& connections, int fd) {
+	epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+	close(fd);
+	connections.erase(fd);
+}
+
+/*Points epoll at what the connection can use right now. Reading stops once the client has shut down its side or while it has MAX_BUFFERED bytes
+waiting in either direction, which is the backpressure for clients that send faster than they read. Writes are only watched while output is left.
+Returns false if epoll would not take the change, the connection should be closed then.*/
+bool updateEvents(int epollFd, Connection& conn) {
+	uint32_t events = 0;
+	if (!conn.readClosed && conn.in.size() < MAX_BUFFERED && conn.out.size() < MAX_BUFFERED) {
+		events |= EPOLLIN;
+	}
+	if (!conn.out.empty()) {
+		events |= EPOLLOUT;
+	}
+	if (events != conn.events) {
+		epoll_event event;
+		event.events = events;
+		event.data.fd = conn.fd;
+		if (epoll_ctl(epollFd, EPOLL_CTL_MOD, conn.fd, &event) < 0) {
+			cout << "epoll_ctl failed for connection " << conn.fd << ": " << strerror(errno) << endl;
+			return false;
+		}
+		conn.events = events;
+	}
+	return true;
+}
+
+/*Writes as much of the pending output as the socket takes. Returns false if the connection is dead.*/
+bool flushConnection(int epollFd, Connection& conn) {
+	size_t written = 0;
+	while (written < conn.out.size()) {
+		ssize_t sent = send(conn.fd, conn.out.data() + written, conn.out.size() - written, MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			return false;
+		}
+		written += sent;
+	}
+	conn.out.erase(0, written);
+	return updateEvents(epollFd, conn);
+}
+
+/*Takes whole requests off the front of a connection into the batch. Inserts are applied before reads in a batch, so once a read has been taken a
+later insert from the same connection has to wait for the next batch, otherwise the read would see it. A connection gives at most MAX_CONNECTION_BATCH
+requests per batch, and none while its unsent output is over MAX_BUFFERED. Returns how many bytes were taken.*/
+size_t takeRequests(Connection& conn, vector<Request>& batch, bool& leftOver) {
+	if (conn.out.size() >= MAX_BUFFERED) {//picked up again once flushConnection drains it
+		return 0;
+	}
+
+	size_t offset = 0;
+	size_t taken = 0;
+	bool tookRead = false;
+	while (conn.in.size() - offset >= REQUEST_SIZE) {
+		const byte* raw = (const byte*)conn.in.data() + offset;
+		if (batch.size() >= MAX_BATCH || taken >= MAX_CONNECTION_BATCH || (raw[0] == OP_INSERT && tookRead)) {
+			leftOver = true;
+			break;
+		}
+
+		Request request;
+		request.conn = &conn;
+		request.op = raw[0];
+		request.key = ((unsigned int)raw[1] << 24) | ((unsigned int)raw[2] << 16) | ((unsigned int)raw[3] << 8) | raw[4];
+		request.digest = raw + 5;
+		batch.push_back(request);
+		if (request.op != OP_INSERT) {
+			tookRead = true;
+		}
+		offset += REQUEST_SIZE;
+		taken++;
+	}
+	return offset;
+}
+
+/*Runs one batch against the tree and queues every response on its connection. Each connection only contributes inserts followed by reads (see
+takeRequests), so answering all inserts and then all reads keeps every connection's responses in request order.*/
+void processBatch(SparseMerkleTree& tree, const vector<Request>& batch) {
+	vector<unsigned int> keys;
+	vector<byte> digests;
+	for (auto& request : batch) {
+		if (request.op == OP_INSERT) {
+			keys.push_back(request.key);
+			digests.insert(digests.end(), request.digest, request.digest + CryptoPP::SHA256::DIGESTSIZE);
+		}
+	}
+	if (!keys.empty()) {
+		tree.InsertBatch(keys, digests);
+	}
+
+	byte root[CryptoPP::SHA256::DIGESTSIZE];
+	tree.getRoot(root);
+	unordered_map<unsigned int, vector<byte>> proofs;//payloads already built in this batch, the root followed by the proof
+
+	for (auto& request : batch) {
+		string& out = request.conn->out;
+		if (request.op == OP_INSERT) {
+			appendResponse(out, STATUS_TRUE, NULL, 0);
+		}
+		else if (request.op == OP_VERIFY) {
+			appendResponse(out, tree.Verify(request.digest, request.key) ? STATUS_TRUE : STATUS_FALSE, NULL, 0);
+		}
+		else if (request.op == OP_ROOT) {
+			appendResponse(out, STATUS_TRUE, root, CryptoPP::SHA256::DIGESTSIZE);
+		}
+		else if (request.op == OP_PROOF) {
+			auto found = proofs.find(request.key);
+			if (found == proofs.end()) {
+				vector<byte> proof;
+				tree.getProof(request.key, proof);
+				found = proofs.insert(pair<unsigned int, vector<byte>>(request.key, vector<byte>(root, root + CryptoPP::SHA256::DIGESTSIZE))).first;
+				found->second.insert(found->second.end(), proof.begin(), proof.end());
+			}
+			byte present = tree.Verify(request.digest, request.key) ? STATUS_TRUE : STATUS_FALSE;
+			appendResponse(out, present, found->second.data(), found->second.size());
+		}
+		else {
+			appendResponse(out, STATUS_BAD_REQUEST, NULL, 0);
+		}
+	}
+}
+
+int main(int argc, char* argv[]) {
+	string path = argc > 1 ? argv[1] : DEFAULT_SOCKET_PATH;
+
+	int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+	unlink(path.c_str());
+	if (listenFd < 0 || bind(listenFd, (sockaddr*)&address, sizeof(address)) < 0 || listen(listenFd, SOMAXCONN) < 0) {
+		cout << "could not listen on " << path << ": " << strerror(errno) << endl;
+		return 1;
+	}
+
+	int epollFd = epoll_create1(0);
+	epoll_event event;
+	event.events = EPOLLIN;
+	event.data.fd = listenFd;
+	if (epollFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) < 0) {
+		cout << "could not set up epoll: " << strerror(errno) << endl;
+		return 1;
+	}
+	cout << "serving on " << path << endl;
+
+	SparseMerkleTree tree;
+	unordered_map<int, Connection> connections;
+	epoll_event events[MAX_EVENTS];
+	vector<Request> batch;
+	bool leftOver = false;//some connection still has whole requests buffered, so do not block in epoll_wait
+	size_t rotation = 0;
+	bool acceptPaused = false;//the listen socket is out of epoll after running out of file descriptors
+	size_t pausedConnections = 0;
+	chrono::steady_clock::time_point pausedAt;
+	char buffer[65536];
+
+	while (true) {
+		int ready = epoll_wait(epollFd, events, MAX_EVENTS, leftOver ? 0 : (acceptPaused ? ACCEPT_BACKOFF_MS : -1));
+		if (ready < 0 && errno != EINTR) {
+			cout << "epoll_wait failed: " << strerror(errno) << endl;
+			return 1;
+		}
+
+		for (int i = 0; i < ready; i++) {
+			int fd = events[i].data.fd;
+			if (fd == listenFd) {
+				int clientFd;
+				while ((clientFd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+					event.events = EPOLLIN;
+					event.data.fd = clientFd;
+					if (epoll_ctl(epollFd, EPOLL_CTL_ADD, clientFd, &event) < 0) {
+						cout << "epoll_ctl failed for new connection: " << strerror(errno) << endl;
+						close(clientFd);
+						continue;
+					}
+					connections[clientFd].fd = clientFd;
+				}
+				if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+					//the listen socket stays readable until the backlog is accepted, so leaving it in epoll would spin at full cpu
+					cout << "accept failed, pausing for " << ACCEPT_BACKOFF_MS << " ms: " << strerror(errno) << endl;
+					epoll_ctl(epollFd, EPOLL_CTL_DEL, listenFd, NULL);
+					acceptPaused = true;
+					pausedConnections = connections.size();
+					pausedAt = chrono::steady_clock::now();
+				}
+				else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED && errno != EINTR) {
+					cout << "accept failed: " << strerror(errno) << endl;
+				}
+				continue;
+			}
+
+			auto conn = connections.find(fd);
+			if (conn == connections.end()) {
+				continue;
+			}
+			if ((events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) && !flushConnection(epollFd, conn->second)) {
+				closeConnection(epollFd, connections, fd);
+				continue;
+			}
+			if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !conn->second.readClosed) {
+				bool failed = false;
+				while (conn->second.in.size() < MAX_BUFFERED) {
+					ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+					if (received > 0) {
+						conn->second.in.append(buffer, received);
+					}
+					else {
+						if (received == 0) {
+							conn->second.readClosed = true;
+						}
+						else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+							failed = true;
+						}
+						break;
+					}
+				}
+				if (failed || !updateEvents(epollFd, conn->second)) {
+					closeConnection(epollFd, connections, fd);
+					continue;
+				}
+			}
+		}
+
+		//start from a different connection every pass so the ones early in the map can not keep filling every batch
+		vector<Connection*> order;
+		for (auto& conn : connections) {
+			order.push_back(&conn.second);
+		}
+		batch.clear();
+		leftOver = false;
+		vector<pair<Connection*, size_t>> taken;
+		for (size_t i = 0; i < order.size(); i++) {
+			Connection* conn = order[(i + rotation) % order.size()];
+			size_t length = takeRequests(*conn, batch, leftOver);
+			if (length > 0) {
+				taken.push_back(pair<Connection*, size_t>(conn, length));
+			}
+		}
+		rotation++;
+
+		if (!batch.empty()) {
+			processBatch(tree, batch);
+		}
+
+		for (auto& conn : taken) {
+			conn.first->in.erase(0, conn.second);
+			if (!flushConnection(epollFd, *conn.first)) {
+				closeConnection(epollFd, connections, conn.first->fd);
+			}
+		}
+
+		//a client that has shut down its side is closed once every whole request it sent has been answered and written
+		vector<int> finished;
+		for (auto& conn : connections) {
+			if (conn.second.readClosed && conn.second.in.size() < REQUEST_SIZE && conn.second.out.empty()) {
+				finished.push_back(conn.first);
+			}
+		}
+		for (int fd : finished) {
+			closeConnection(epollFd, connections, fd);
+		}
+
+		//accept again once a connection has given its descriptor back or the backoff is over
+		if (acceptPaused && (connections.size() < pausedConnections
+			|| chrono::steady_clock::now() - pausedAt >= chrono::milliseconds(ACCEPT_BACKOFF_MS))) {
+			event.events = EPOLLIN;
+			event.data.fd = listenFd;
+			if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) < 0) {
+				cout << "could not resume accepting: " << strerror(errno) << endl;
+				return 1;
+			}
+			acceptPaused = false;
+		}
+	}
+
+	return 0;
+}
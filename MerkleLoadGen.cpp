@@ -0,0 +1,156 @@
+#include<iostream>
+#include<vector>
+#include<string>
+#include<thread>
+#include<chrono>
+#include<deque>
+#include<algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "MerkleProtocol.h"
+
+using namespace std;
+using namespace CryptoPP;
+
+/*Load generator for MerkleDaemon. Opens CONNECTIONS connections, each on its own thread, and keeps PIPELINE requests in flight on each until it has
+sent REQUESTS of them, a mix of inserts, verifies, proofs and roots over a key space of KEYS keys. Prints throughput and latency percentiles.
+Usage: MerkleLoadGen [socket path] [connections] [requests per connection] [pipeline depth] [insert percent]
+Build with: g++ -std=c++14 -O2 -pthread MerkleLoadGen.cpp -lcryptopp -o MerkleLoadGen*/
+
+#define KEYS 1000000
+
+typedef chrono::steady_clock Clock;
+
+bool sendAll(int fd, const byte data[], size_t length) {
+	while (length > 0) {
+		ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+		if (sent <= 0) {
+			return false;
+		}
+		data += sent;
+		length -= sent;
+	}
+	return true;
+}
+
+bool receiveAll(int fd, byte data[], size_t length) {
+	while (length > 0) {
+		ssize_t received = recv(fd, data, length, 0);
+		if (received <= 0) {
+			return false;
+		}
+		data += received;
+		length -= received;
+	}
+	return true;
+}
+
+/*One connection's worth of load. Latencies are measured from the moment a request is sent to the moment its response has been read in full, in
+microseconds, and pushed onto latencies.*/
+void runClient(string path, int requests, int pipeline, int insertPercent, unsigned int seed, vector<double>* latencies, int* failed) {
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+	if (fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+		*failed = 1;
+		return;
+	}
+
+	SHA256 hash;
+	byte request[REQUEST_SIZE];
+	byte response[65536];
+	deque<Clock::time_point> inFlight;
+	int sent = 0;
+	while (sent < requests || !inFlight.empty()) {
+		while (sent < requests && (int)inFlight.size() < pipeline) {
+			unsigned int key = rand_r(&seed) % KEYS;
+			int pick = rand_r(&seed) % 100;
+			if (pick < insertPercent) {
+				request[0] = OP_INSERT;
+			}
+			else {
+				int read = pick % 3;
+				request[0] = read == 0 ? OP_VERIFY : (read == 1 ? OP_PROOF : OP_ROOT);
+			}
+			request[1] = (byte)(key >> 24);
+			request[2] = (byte)(key >> 16);
+			request[3] = (byte)(key >> 8);
+			request[4] = (byte)key;
+			hash.CalculateDigest(request + 5, (const byte*)&key, sizeof(key));//same digest per key so verifies of inserted keys succeed
+
+			inFlight.push_back(Clock::now());
+			if (!sendAll(fd, request, REQUEST_SIZE)) {
+				*failed = 1;
+				close(fd);
+				return;
+			}
+			sent++;
+		}
+
+		if (!receiveAll(fd, response, RESPONSE_HEADER_SIZE)) {
+			*failed = 1;
+			close(fd);
+			return;
+		}
+		size_t length = ((size_t)response[1] << 8) | response[2];
+		if (!receiveAll(fd, response + RESPONSE_HEADER_SIZE, length)) {
+			*failed = 1;
+			close(fd);
+			return;
+		}
+		latencies->push_back(chrono::duration<double, micro>(Clock::now() - inFlight.front()).count());
+		inFlight.pop_front();
+	}
+	close(fd);
+}
+
+int main(int argc, char* argv[]) {
+	string path = argc > 1 ? argv[1] : DEFAULT_SOCKET_PATH;
+	int connections = argc > 2 ? atoi(argv[2]) : 8;
+	int requests = argc > 3 ? atoi(argv[3]) : 100000;
+	int pipeline = argc > 4 ? atoi(argv[4]) : 16;
+	int insertPercent = argc > 5 ? atoi(argv[5]) : 50;
+	if (connections <= 0 || requests <= 0 || pipeline <= 0 || insertPercent < 0 || insertPercent > 100) {
+		cout << "connections, requests and pipeline depth must be positive and insert percent between 0 and 100" << endl;
+		return 1;
+	}
+
+	vector<vector<double>> latencies(connections);
+	vector<int> failed(connections, 0);
+	vector<thread> clients;
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < connections; i++) {
+		latencies[i].reserve(requests);
+		clients.push_back(thread(runClient, path, requests, pipeline, insertPercent, (unsigned int)i + 1, &latencies[i], &failed[i]));
+	}
+	for (auto& client : clients) {
+		client.join();
+	}
+	double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+	vector<double> all;
+	for (int i = 0; i < connections; i++) {
+		if (failed[i]) {
+			cout << "connection " << i << " failed" << endl;
+		}
+		all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+	}
+	if (all.empty()) {
+		cout << "no responses received" << endl;
+		return 1;
+	}
+	sort(all.begin(), all.end());
+
+	cout << all.size() << " requests in " << seconds << " s, " << (size_t)(all.size() / seconds) << " requests/s" << endl;
+	cout << "latency us: p50 " << all[all.size() / 2]
+		<< ", p99 " << all[all.size() * 99 / 100]
+		<< ", p99.9 " << all[all.size() * 999 / 1000]
+		<< ", max " << all.back() << endl;
+	return 0;
+}
@@ -0,0 +1,449 @@
+#include "MerkleMountainRange.h"
+#include <stdexcept>
+
+using namespace std;
+
+MerkleMountainRange::MerkleMountainRange() {
+	this->leafCount = 0;
+	this->tiered = false;
+	this->leafFileDirty = false;
+	this->pinnedHeight = 0;
+	this->cacheSize = 0;
+}
+
+/*Tiered constructor for logs that do not fit in memory. Leaf hashes are written to the file at path (truncated first) as a flat array, nodes at or
+above pinnedHeight stay in memory, and nodes below it are recomputed from the leaves when needed and kept in an LRU cache of cacheSize nodes. A lookup
+that misses the cache costs at most 2^pinnedHeight leaf reads, so pinnedHeight trades memory (about n / 2^pinnedHeight pinned nodes) for proof latency.*/
+MerkleMountainRange::MerkleMountainRange(const string& path, int pinnedHeight, size_t cacheSize) {
+	this->leafCount = 0;
+	this->tiered = true;
+	this->leafFileDirty = false;
+	this->pinnedHeight = pinnedHeight;
+	this->cacheSize = cacheSize;
+	leafFile.open(path, ios::in | ios::out | ios::binary | ios::trunc);
+	if (!leafFile.is_open()) {
+		throw runtime_error("could not open leaf file " + path);
+	}
+}
+
+/*Position of the given leaf in the post order node array. Every leaf before it brought one node with it, plus one parent for every merge, and the
+number of merges so far is the number of leaves minus the number of peaks (set bits) they form.*/
+size_t MerkleMountainRange::leafPosition(size_t leaf) {
+	size_t bits = 0;
+	for (size_t i = leaf; i != 0; i &= i - 1) {
+		bits++;
+	}
+	return 2 * leaf - bits;
+}
+
+/*Position of the node at the given height that covers leaves [index * 2^height, (index + 1) * 2^height). In post order a node is written right after
+its right most leaf and the chain of parents above that leaf, so it sits height places after that leaf.*/
+size_t MerkleMountainRange::nodePosition(int height, size_t index) {
+	return leafPosition(((index + 1) << height) - 1) + height;
+}
+
+/*Fills peaks with the (height, index) of every mountain for a log with leafCount leaves, from the left most (tallest) to the right most. There is one
+peak for every set bit of leafCount.*/
+void MerkleMountainRange::getPeaks(size_t leafCount, vector<pair<int, size_t>>& peaks) {
+	peaks.clear();
+	size_t start = 0;
+	for (int height = sizeof(size_t) * 8 - 1; height >= 0; height--) {
+		size_t width = (size_t)1 << height;
+		if (leafCount & width) {
+			peaks.push_back(pair<int, size_t>(height, start >> height));
+			start += width;
+		}
+	}
+}
+
+/*Fills rangeNodes with the (height, index) of the fewest full subtrees that exactly cover leaves [from, to), left to right. Each one is as tall as
+its alignment and the end of the range allow, so there are at most two per bit of to and every one of them is a node of any log with at least to leaves.*/
+void MerkleMountainRange::getRangeNodes(size_t from, size_t to, vector<pair<int, size_t>>& rangeNodes) {
+	rangeNodes.clear();
+	size_t start = from;
+	while (start < to) {
+		int height = 0;
+		while ((start & (((size_t)2 << height) - 1)) == 0 && start + ((size_t)2 << height) <= to) {
+			height++;
+		}
+		rangeNodes.push_back(pair<int, size_t>(height, start >> height));
+		start += (size_t)1 << height;
+	}
+}
+
+/*Folds the peak hashes into a single root from right to left, so root = H(peak0, H(peak1, ... H(peakn-1, peakn))). An empty log has the hash of
+the empty string as its root, the same as an empty canonical MerkleTree.*/
+void MerkleMountainRange::bagPeaks(byte out[], const vector<byte>& peakHashes) {
+	size_t count = peakHashes.size() / CryptoPP::SHA256::DIGESTSIZE;
+	if (count == 0) {
+		SHA256 hash;
+		hash.CalculateDigest(out, NULL, 0);
+		return;
+	}
+
+	byte bag[CryptoPP::SHA256::DIGESTSIZE];
+	for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+		bag[i] = peakHashes[(count - 1) * CryptoPP::SHA256::DIGESTSIZE + i];
+	}
+	for (size_t i = count - 1; i > 0; i--) {
+		MerkleTree::hashNode(bag, &peakHashes[(i - 1) * CryptoPP::SHA256::DIGESTSIZE], bag);
+	}
+	for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+		out[i] = bag[i];
+	}
+}
+
+/*Copies the hash of the node at the given height and index into out. In memory it is read straight out of the node array. In tiered mode pinned
+nodes are read from memory and anything else from the cache. On a miss the node is rebuilt from the leaf file and only that node is cached, so a
+rebuild never pushes out the neighbours a proof walk is about to ask for.*/
+void MerkleMountainRange::getNode(int height, size_t index, byte out[]) {
+	if (findNode(height, index, out)) {
+		return;
+	}
+	rebuildNode(height, index, out);
+	cacheNode(nodePosition(height, index), out);
+}
+
+/*Copies the node into out if it is held in memory (the node array, the pinned levels or the cache) and returns whether it was*/
+bool MerkleMountainRange::findNode(int height, size_t index, byte out[]) {
+	const byte* found = NULL;
+	if (!tiered) {
+		found = &nodes[nodePosition(height, index) * CryptoPP::SHA256::DIGESTSIZE];
+	}
+	else if (height >= pinnedHeight) {
+		found = &pinned[height - pinnedHeight][index * CryptoPP::SHA256::DIGESTSIZE];
+	}
+	else {
+		auto cached = cacheIndex.find(nodePosition(height, index));
+		if (cached == cacheIndex.end()) {
+			return false;
+		}
+		cache.splice(cache.begin(), cache, cached->second);
+		found = cached->second->hash;
+	}
+
+	for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+		out[i] = found[i];
+	}
+	return true;
+}
+
+/*Computes a node that is not in memory. A leaf is read from the leaf file, an interior node is hashed from its two children, using any child that
+is still in memory and rebuilding the rest the same way. Nothing rebuilt here is cached. Throws runtime_error if the leaf file can not be read.*/
+void MerkleMountainRange::rebuildNode(int height, size_t index, byte out[]) {
+	if (height == 0) {
+		if (leafFileDirty) {
+			leafFile.flush();
+			leafFileDirty = false;
+		}
+		leafFile.seekg(index * CryptoPP::SHA256::DIGESTSIZE);
+		leafFile.read((char*)out, CryptoPP::SHA256::DIGESTSIZE);
+		if (!leafFile) {
+			throw runtime_error("could not read leaf " + to_string(index) + " from the leaf file");
+		}
+		return;
+	}
+
+	byte left[CryptoPP::SHA256::DIGESTSIZE];
+	byte right[CryptoPP::SHA256::DIGESTSIZE];
+	if (!findNode(height - 1, 2 * index, left)) {
+		rebuildNode(height - 1, 2 * index, left);
+	}
+	if (!findNode(height - 1, 2 * index + 1, right)) {
+		rebuildNode(height - 1, 2 * index + 1, right);
+	}
+	MerkleTree::hashNode(out, left, right);
+}
+
+/*Records a newly created node. In memory it is simply appended, which is its post order position since Append creates nodes in that order. In tiered
+mode leaves also go to the end of the leaf file, then the node is pinned if it is tall enough or put in the cache otherwise since new nodes are the
+ones proofs are most likely to ask about. Throws runtime_error if the leaf file can not be written, rather than leave a gap that later reads would
+turn into a wrong root.*/
+void MerkleMountainRange::storeNode(int height, size_t index, const byte hash[]) {
+	if (!tiered) {
+		nodes.insert(nodes.end(), hash, hash + CryptoPP::SHA256::DIGESTSIZE);
+		return;
+	}
+
+	if (height == 0) {
+		leafFile.seekp(index * CryptoPP::SHA256::DIGESTSIZE);
+		leafFile.write((const char*)hash, CryptoPP::SHA256::DIGESTSIZE);
+		if (!leafFile) {
+			throw runtime_error("could not write leaf " + to_string(index) + " to the leaf file");
+		}
+		leafFileDirty = true;
+	}
+
+	if (height >= pinnedHeight) {//appends create the nodes of each height in index order, so this is always the end of that height's array
+		if ((int)pinned.size() <= height - pinnedHeight) {
+			pinned.resize(height - pinnedHeight + 1);
+		}
+		vector<byte>& level = pinned[height - pinnedHeight];
+		level.insert(level.end(), hash, hash + CryptoPP::SHA256::DIGESTSIZE);
+	}
+	else {
+		cacheNode(nodePosition(height, index), hash);
+	}
+}
+
+/*Puts a node at the front of the LRU cache, evicting from the back once there are more than cacheSize nodes. Evicted nodes are not written anywhere,
+getNode can always rebuild them from the leaf file.*/
+void MerkleMountainRange::cacheNode(size_t position, const byte hash[]) {
+	if (cacheSize == 0) {
+		return;
+	}
+
+	CachedNode node;
+	node.position = position;
+	for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+		node.hash[i] = hash[i];
+	}
+	cache.push_front(node);
+	cacheIndex[position] = cache.begin();
+
+	if (cache.size() > cacheSize) {
+		cacheIndex.erase(cache.back().position);
+		cache.pop_back();
+	}
+}
+
+/*Appends a leaf to the end of the log. The leaf hash is written first, then while the new node is a right child its parent is written after it, so an
+append costs one leaf hash plus one parent hash per trailing one bit of the old leaf count, which averages out to two hashes per append.*/
+void MerkleMountainRange::Append(const byte digest[]) {
+	byte node[CryptoPP::SHA256::DIGESTSIZE];
+	byte sibling[CryptoPP::SHA256::DIGESTSIZE];
+	MerkleTree::hashLeaf(node, digest, CryptoPP::SHA256::DIGESTSIZE);
+	storeNode(0, leafCount, node);
+
+	int height = 0;
+	for (size_t index = leafCount; index & 1; index >>= 1) {
+		if (tiered) {//the left sibling is always the last peak, which is kept in memory
+			for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+				sibling[i] = peakHashes[peakHashes.size() - CryptoPP::SHA256::DIGESTSIZE + i];
+			}
+			peakHashes.resize(peakHashes.size() - CryptoPP::SHA256::DIGESTSIZE);
+		}
+		else {
+			getNode(height, index - 1, sibling);
+		}
+		MerkleTree::hashNode(node, sibling, node);
+		height++;
+		storeNode(height, index >> 1, node);
+	}
+	if (tiered) {
+		peakHashes.insert(peakHashes.end(), node, node + CryptoPP::SHA256::DIGESTSIZE);
+	}
+	leafCount++;
+}
+
+/*Number of leaves appended so far*/
+size_t MerkleMountainRange::size() {
+	return leafCount;
+}
+
+/*Number of hashes in the log, leaves and parents together, which is where the next leaf would go*/
+size_t MerkleMountainRange::nodeCount() {
+	return leafPosition(leafCount);
+}
+
+/*The raw node array, nodeCount() * DIGESTSIZE bytes in post order. Since it is append only a copy on disk stays valid as the log grows.
+Empty in tiered mode, where the leaf file plays this role instead.*/
+const byte* MerkleMountainRange::data() {
+	return nodes.data();
+}
+
+/*Bags the current peaks into out. Nothing is cached, there are at most one peak per bit of the leaf count so this is O(log n) hashes.*/
+void MerkleMountainRange::getRoot(byte out[]) {
+	getRoot(out, leafCount);
+}
+
+/*Root the log had when it held treeSize leaves. Appends never touch nodes that are already written, so every earlier peak is still in the array.
+Throws out_of_range if treeSize is larger than the log, whose peaks do not exist yet.*/
+void MerkleMountainRange::getRoot(byte out[], size_t treeSize) {
+	if (treeSize > leafCount) {
+		throw out_of_range("log has " + to_string(leafCount) + " leaves, no root at size " + to_string(treeSize));
+	}
+	if (tiered && treeSize == leafCount) {
+		bagPeaks(out, peakHashes);
+		return;
+	}
+
+	vector<pair<int, size_t>> peaks;
+	getPeaks(treeSize, peaks);
+
+	vector<byte> peakHashes(peaks.size() * CryptoPP::SHA256::DIGESTSIZE);
+	for (size_t i = 0; i < peaks.size(); i++) {
+		getNode(peaks[i].first, peaks[i].second, &peakHashes[i * CryptoPP::SHA256::DIGESTSIZE]);
+	}
+	bagPeaks(out, peakHashes);
+}
+
+/*Fills proof with the hashes needed to get from the given leaf to the current root: the siblings on the way up to the leafs peak from the bottom
+up, then every other peak from left to right. Each entry is DIGESTSIZE bytes.*/
+void MerkleMountainRange::inclusionProof(size_t leaf, vector<byte>& proof) {
+	proof.clear();
+	if (leaf >= leafCount) {
+		return;
+	}
+
+	vector<pair<int, size_t>> peaks;
+	getPeaks(leafCount, peaks);
+
+	byte node[CryptoPP::SHA256::DIGESTSIZE];
+	for (auto peak : peaks) {
+		if ((leaf >> peak.first) == peak.second) {
+			size_t index = leaf;
+			for (int height = 0; height < peak.first; height++) {
+				getNode(height, index ^ 1, node);
+				proof.insert(proof.end(), node, node + CryptoPP::SHA256::DIGESTSIZE);
+				index >>= 1;
+			}
+		}
+	}
+	for (auto peak : peaks) {
+		if ((leaf >> peak.first) != peak.second) {
+			getNode(peak.first, peak.second, node);
+			proof.insert(proof.end(), node, node + CryptoPP::SHA256::DIGESTSIZE);
+		}
+	}
+}
+
+/*Checks a proof from inclusionProof without needing the log itself, only the leaf digest, its index, the size of the log the proof was made at and
+that logs root. Climbs to the leafs peak, slots it in with the other peaks from the proof and compares the bagged result to root.*/
+bool MerkleMountainRange::verifyInclusion(const byte digest[], size_t leaf, size_t leafCount, const vector<byte>& proof, const byte root[]) {
+	if (leaf >= leafCount) {
+		return false;
+	}
+
+	vector<pair<int, size_t>> peaks;
+	getPeaks(leafCount, peaks);
+
+	int pathLength = 0;
+	for (auto peak : peaks) {
+		if ((leaf >> peak.first) == peak.second) {
+			pathLength = peak.first;
+		}
+	}
+	if (proof.size() != (pathLength + peaks.size() - 1) * CryptoPP::SHA256::DIGESTSIZE) {
+		return false;
+	}
+
+	byte node[CryptoPP::SHA256::DIGESTSIZE];
+	MerkleTree::hashLeaf(node, digest, CryptoPP::SHA256::DIGESTSIZE);
+	size_t index = leaf;
+	size_t next = 0;
+	for (int height = 0; height < pathLength; height++) {
+		if (index & 1) {
+			MerkleTree::hashNode(node, &proof[next], node);
+		}
+		else {
+			MerkleTree::hashNode(node, node, &proof[next]);
+		}
+		next += CryptoPP::SHA256::DIGESTSIZE;
+		index >>= 1;
+	}
+
+	vector<byte> peakHashes;
+	for (auto peak : peaks) {
+		if ((leaf >> peak.first) == peak.second) {
+			peakHashes.insert(peakHashes.end(), node, node + CryptoPP::SHA256::DIGESTSIZE);
+		}
+		else {
+			peakHashes.insert(peakHashes.end(), proof.begin() + next, proof.begin() + next + CryptoPP::SHA256::DIGESTSIZE);
+			next += CryptoPP::SHA256::DIGESTSIZE;
+		}
+	}
+
+	byte expected[CryptoPP::SHA256::DIGESTSIZE];
+	bagPeaks(expected, peakHashes);
+	for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+		if (expected[i] != root[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*Fills proof with what an auditor needs to check that the log at newSize only extends the log at oldSize: the peaks at oldSize, left to right,
+followed by the subtrees covering the leaves appended since, from getRangeNodes. Both sizes must be no larger than the current size.*/
+void MerkleMountainRange::consistencyProof(size_t oldSize, size_t newSize, vector<byte>& proof) {
+	proof.clear();
+	if (oldSize > newSize || newSize > leafCount) {
+		return;
+	}
+
+	vector<pair<int, size_t>> proofNodes;
+	vector<pair<int, size_t>> rangeNodes;
+	getPeaks(oldSize, proofNodes);
+	getRangeNodes(oldSize, newSize, rangeNodes);
+	proofNodes.insert(proofNodes.end(), rangeNodes.begin(), rangeNodes.end());
+
+	proof.resize(proofNodes.size() * CryptoPP::SHA256::DIGESTSIZE);
+	for (size_t i = 0; i < proofNodes.size(); i++) {
+		getNode(proofNodes[i].first, proofNodes[i].second, &proof[i * CryptoPP::SHA256::DIGESTSIZE]);
+	}
+}
+
+/*Checks a proof from consistencyProof using only the two roots. The old peaks from the proof must bag to oldRoot, then the new subtrees are appended
+onto them exactly like Append merges leaves, and the peaks that come out of that must bag to newRoot. Since the old peaks are hashed into the new
+ones, history before oldSize cannot have been rewritten. Costs O(log n) hashes.*/
+bool MerkleMountainRange::verifyConsistency(size_t oldSize, size_t newSize, const byte oldRoot[], const byte newRoot[], const vector<byte>& proof) {
+	if (oldSize > newSize) {
+		return false;
+	}
+
+	vector<pair<int, size_t>> oldPeaks;
+	vector<pair<int, size_t>> rangeNodes;
+	getPeaks(oldSize, oldPeaks);
+	getRangeNodes(oldSize, newSize, rangeNodes);
+	if (proof.size() != (oldPeaks.size() + rangeNodes.size()) * CryptoPP::SHA256::DIGESTSIZE) {
+		return false;
+	}
+
+	byte root[CryptoPP::SHA256::DIGESTSIZE];
+	vector<byte> peakHashes(proof.begin(), proof.begin() + oldPeaks.size() * CryptoPP::SHA256::DIGESTSIZE);
+	bagPeaks(root, peakHashes);
+	for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+		if (root[i] != oldRoot[i]) {
+			return false;
+		}
+	}
+
+	vector<int> heights;
+	for (auto peak : oldPeaks) {
+		heights.push_back(peak.first);
+	}
+	size_t next = peakHashes.size();
+	for (auto node : rangeNodes) {
+		peakHashes.insert(peakHashes.end(), proof.begin() + next, proof.begin() + next + CryptoPP::SHA256::DIGESTSIZE);
+		next += CryptoPP::SHA256::DIGESTSIZE;
+		heights.push_back(node.first);
+
+		while (heights.size() >= 2 && heights[heights.size() - 1] == heights[heights.size() - 2]) {
+			byte* left = &peakHashes[peakHashes.size() - 2 * CryptoPP::SHA256::DIGESTSIZE];
+			MerkleTree::hashNode(left, left, left + CryptoPP::SHA256::DIGESTSIZE);
+			peakHashes.resize(peakHashes.size() - CryptoPP::SHA256::DIGESTSIZE);
+			heights.pop_back();
+			heights.back()++;
+		}
+	}
+
+	vector<pair<int, size_t>> newPeaks;
+	getPeaks(newSize, newPeaks);
+	if (heights.size() != newPeaks.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < newPeaks.size(); i++) {
+		if (heights[i] != newPeaks[i].first) {
+			return false;
+		}
+	}
+
+	bagPeaks(root, peakHashes);
+	for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+		if (root[i] != newRoot[i]) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "MerkleTree.h"
+#include <vector>
+#include <list>
+#include <fstream>
+#include <string>
+
+using namespace std;
+using namespace CryptoPP;
+
+struct CachedNode {
+	size_t position;
+	byte hash[CryptoPP::SHA256::DIGESTSIZE];
+};
+
+/*Append only alternative to MerkleTree for logs. Nodes are never moved or rehashed once written so the whole structure is a flat array of hashes in
+post order, which can be written straight to disk or memory mapped. Uses the same 0x00/0x01 prefixed hashing as the canonical MerkleTree.*/
+class MerkleMountainRange{
+	private:
+		vector<byte> nodes;//every node hash back to back in post order, DIGESTSIZE bytes each
+		size_t leafCount;
+		bool tiered;//tiered mode keeps only the leaves on disk and the tall nodes in memory, everything in between is recomputed through the cache
+		fstream leafFile;
+		bool leafFileDirty;
+		int pinnedHeight;
+		vector<vector<byte>> pinned;//nodes at or above pinnedHeight, one flat array per height indexed like the leaves, never evicted
+		vector<byte> peakHashes;//current peaks left to right so appends never have to go to disk
+		list<CachedNode> cache;//most recently used at the front
+		unordered_map<size_t, list<CachedNode>::iterator> cacheIndex;
+		size_t cacheSize;
+		static size_t leafPosition(size_t leaf);
+		static size_t nodePosition(int height, size_t index);
+		static void getPeaks(size_t leafCount, vector<pair<int, size_t>>& peaks);
+		static void getRangeNodes(size_t from, size_t to, vector<pair<int, size_t>>& rangeNodes);
+		static void bagPeaks(byte out[], const vector<byte>& peakHashes);
+		void getNode(int height, size_t index, byte out[]);
+		bool findNode(int height, size_t index, byte out[]);
+		void rebuildNode(int height, size_t index, byte out[]);
+		void storeNode(int height, size_t index, const byte hash[]);
+		void cacheNode(size_t position, const byte hash[]);
+
+	public:
+		MerkleMountainRange();
+		MerkleMountainRange(const string& path, int pinnedHeight, size_t cacheSize);
+		void Append(const byte digest[]);
+		size_t size();
+		size_t nodeCount();
+		const byte* data();
+		void getRoot(byte out[]);
+		void getRoot(byte out[], size_t treeSize);
+		void inclusionProof(size_t leaf, vector<byte>& proof);
+		static bool verifyInclusion(const byte digest[], size_t leaf, size_t leafCount, const vector<byte>& proof, const byte root[]);
+		void consistencyProof(size_t oldSize, size_t newSize, vector<byte>& proof);
+		static bool verifyConsistency(size_t oldSize, size_t newSize, const byte oldRoot[], const byte newRoot[], const vector<byte>& proof);
+};
@@ -0,0 +1,16 @@
+#pragma once
+#include "cryptlib.h"
+#include "sha.h"
+
+using namespace CryptoPP;
+
+/*Wire format shared by MerkleDaemon and MerkleLoadGen. Every request is a fixed REQUEST_SIZE bytes: an opcode, the key in big endian and a digest
+(ignored by root and proof). Every response is a status byte, a big endian payload length and then the payload. Responses on a connection come back
+in the same order as its requests so clients can pipeline. An OP_PROOF payload is the root the proof was built against followed by the proof from
+SparseMerkleTree::getProof, so it can be checked without a separate OP_ROOT that might land in a different batch.*/
+#define DEFAULT_SOCKET_PATH "/tmp/merkle.sock"
+#define REQUEST_SIZE (1 + 4 + CryptoPP::SHA256::DIGESTSIZE)
+#define RESPONSE_HEADER_SIZE 3
+
+enum opcode {OP_INSERT = 1, OP_VERIFY = 2, OP_ROOT = 3, OP_PROOF = 4};
+enum status {STATUS_FALSE = 0, STATUS_TRUE = 1, STATUS_BAD_REQUEST = 2};//for OP_PROOF true means the key holds the given digest
@@ -1,16 +1,31 @@
 #include "MerkleTree.h"
+#include <stdexcept>
 
 using namespace std;
 
-MerkleTree::MerkleTree() {
-
+/*Canonical mode is opt in so the existing red black tree behaviour stays the default. In canonical mode leaf hashes are prefixed with 0x00 and
+interior hashes with 0x01, and the shape is a balanced tree over the leaves sorted by key, so two trees holding the same leaves always agree on the root.*/
+MerkleTree::MerkleTree(bool canonical) {
+	this->canonical = canonical;
+	this->rootIsStale = true;
 }
 
 /*This function inserts into the merkle tree taking in the hash has an array of byts and the key as an unsinged int.
 If the root is non-existent or is a leaf node, it simply inserts into the red black tree and assings the key which is mapped to a hash
 to the hash passed through. Otherwise, it will do the same thing but also insert a key that is 50 less than the input key along with a new 
-hash value for it and recalculate the hash for there parents until we get to the root.*/
+hash value for it and recalculate the hash for there parents until we get to the root. Inserting a key that is already there keeps the old hash.
+In canonical mode only the prefixed leaf hash is stored and the red black tree is not touched, and inserting an existing key replaces its hash.*/
 void MerkleTree::Insert(const byte digest[], const unsigned int key) {
+	if (canonical) {
+		auto existing = leaves.find(key);
+		if (existing == leaves.end()) {
+			existing = leaves.insert(pair<unsigned int, byte*>(key, new byte[CryptoPP::SHA256::DIGESTSIZE])).first;
+		}
+		canonicalLeafHash(existing->second, digest, key);//hashed here once so getRoot only has to redo the interior nodes
+		rootIsStale = true;
+		return;
+	}
+
 	bool noExtraInsertion = false;//no need for extra insert when inserting to an empty tree
 	if (Tree.getRoot() == NULL) {
 		noExtraInsertion = true;
@@ -40,6 +55,21 @@ void MerkleTree::Insert(const byte digest[], const unsigned int key) {
 /*This method takes in a data node and the key you are querying to see if it exists in the tree.  It will then identify all necessary nodes to retrieve the hashes from, acquire the hashes,
 and verify that they match the hash.*/
 bool MerkleTree::Verify(const byte digest[], const unsigned int key) {
+	if (canonical) {//no interior hashes are stored in canonical mode, they are all derived from the leaves in getRoot
+		auto leaf = leaves.find(key);
+		if (leaf == leaves.end()) {
+			return false;
+		}
+		byte expected[CryptoPP::SHA256::DIGESTSIZE];
+		canonicalLeafHash(expected, digest, key);
+		for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+			if (leaf->second[i] != expected[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
 	for (auto i : map) {
 		if (i.first % 100 == 0) {
 			reHashAncestors(i.first);
@@ -139,8 +169,96 @@ void MerkleTree::print() {
 	Tree.printTree();
 }
 
+/*Copies the canonical root into out. The interior nodes are rebuilt from the stored leaf hashes whenever an insert has happened since the last call,
+so the first root after a change costs O(n) hashes and later calls are free until the next insert. An empty tree has the hash of the empty string as
+its root. Throws logic_error outside canonical mode, where ancestors are only rehashed inside Verify so the red black tree root would be stale.*/
+void MerkleTree::getRoot(byte out[]) {
+	if (!canonical) {
+		throw logic_error("getRoot is only available in canonical mode");
+	}
+
+	if (rootIsStale) {
+		if (leaves.empty()) {
+			hash.CalculateDigest(canonicalRoot, NULL, 0);
+		}
+		else {
+			vector<byte> leafHashes(leaves.size() * CryptoPP::SHA256::DIGESTSIZE);
+			size_t index = 0;
+			for (auto i : leaves) {
+				for (int j = 0; j < CryptoPP::SHA256::DIGESTSIZE; j++) {
+					leafHashes[index * CryptoPP::SHA256::DIGESTSIZE + j] = i.second[j];
+				}
+				index++;
+			}
+			canonicalHash(canonicalRoot, leafHashes, 0, leaves.size());
+		}
+		rootIsStale = false;
+	}
+
+	for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+		out[i] = canonicalRoot[i];
+	}
+}
+
+/*Leaf hash stored for a key in canonical mode. Each leaf commits to its key as well as its digest so moving a digest to another key changes the root.*/
+void MerkleTree::canonicalLeafHash(byte out[], const byte digest[], const unsigned int key) {
+	byte data[4 + CryptoPP::SHA256::DIGESTSIZE];
+	data[0] = (byte)(key >> 24);
+	data[1] = (byte)(key >> 16);
+	data[2] = (byte)(key >> 8);
+	data[3] = (byte)key;
+	for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+		data[4 + i] = digest[i];
+	}
+	hashLeaf(out, data, sizeof(data));
+}
+
+/*Hashes count leaf hashes starting at first into out. The left subtree always takes the largest power of two that is smaller than count, which is
+the same split certificate transparency logs use, so the shape is fixed by the number of leaves alone and never by insertion order.*/
+void MerkleTree::canonicalHash(byte out[], const vector<byte>& leafHashes, size_t first, size_t count) {
+	if (count == 1) {
+		for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+			out[i] = leafHashes[first * CryptoPP::SHA256::DIGESTSIZE + i];
+		}
+		return;
+	}
+
+	size_t split = 1;
+	while (split * 2 < count) {
+		split *= 2;
+	}
+
+	byte left[CryptoPP::SHA256::DIGESTSIZE];
+	byte right[CryptoPP::SHA256::DIGESTSIZE];
+	canonicalHash(left, leafHashes, first, split);
+	canonicalHash(right, leafHashes, first + split, count - split);
+	hashNode(out, left, right);
+}
+
+/*Leaf hash with the 0x00 domain separation prefix. Without the prefix an interior node's 64 byte preimage could be passed off as a leaf.*/
+void MerkleTree::hashLeaf(byte out[], const byte data[], size_t length) {
+	SHA256 leafHash;
+	const byte prefix = 0x00;
+	leafHash.Update(&prefix, 1);
+	leafHash.Update(data, length);
+	leafHash.Final(out);
+}
+
+/*Interior hash with the 0x01 domain separation prefix, taking the left and right child hashes in that order.*/
+void MerkleTree::hashNode(byte out[], const byte left[], const byte right[]) {
+	SHA256 nodeHash;
+	const byte prefix = 0x01;
+	nodeHash.Update(&prefix, 1);
+	nodeHash.Update(left, CryptoPP::SHA256::DIGESTSIZE);
+	nodeHash.Update(right, CryptoPP::SHA256::DIGESTSIZE);
+	nodeHash.Final(out);
+}
+
 MerkleTree::~MerkleTree() {
 	for (auto i : map) {
 		delete[] i.second;
 	}
+	for (auto i : leaves) {
+		delete[] i.second;
+	}
 }
@@ -6,6 +6,7 @@
 #include "cryptlib.h"
 #include "sha.h"
 #include <unordered_map>
+#include <map>
 
 using namespace std;
 using namespace CryptoPP;
@@ -15,9 +16,15 @@ class MerkleTree{
 		RBTree Tree;
 		unordered_map<unsigned int, byte*> map;//faster than regular map which keeps in a bst anyways
 		SHA256 hash;//just to create new hash's
+		bool canonical;//canonical mode ignores the red black tree and builds a balanced tree over the leaves sorted by key
+		std::map<unsigned int, byte*> leaves;//only used in canonical mode, prefixed leaf hashes ordered so the shape only depends on the leaf set
+		byte canonicalRoot[CryptoPP::SHA256::DIGESTSIZE];
+		bool rootIsStale;
+		static void canonicalLeafHash(byte out[], const byte digest[], const unsigned int key);
+		void canonicalHash(byte out[], const vector<byte>& leafHashes, size_t first, size_t count);
 
 	public:
-		MerkleTree();
+		MerkleTree(bool canonical = false);
 		~MerkleTree();
 		void Insert(const byte digest[], const unsigned int key);
 		bool Verify(const byte digest[], const unsigned int key);
@@ -25,5 +32,8 @@ class MerkleTree{
 		void reHashAncestors(int key);
 		byte* calculateProperHash(int key);
 		void print();
+		void getRoot(byte out[]);
+		static void hashLeaf(byte out[], const byte data[], size_t length);
+		static void hashNode(byte out[], const byte left[], const byte right[]);
 };
 
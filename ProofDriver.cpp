@@ -0,0 +1,318 @@
+#include<iostream>
+#include<vector>
+#include<string>
+#include <cstdlib>
+#include <ctime>
+#include <cstdio>
+#include <stdexcept>
+
+#include "MerkleTree.h"
+#include "MerkleMountainRange.h"
+#include "SparseMerkleTree.h"
+
+using namespace std;
+using namespace CryptoPP;
+
+#define NUM_MESSAGES 100
+#define SCALING 100
+
+/*Round trip checks for the canonical MerkleTree and the proof structures built next to it. Each check prints whether it verified correctly, and
+each verifier is also handed something tampered that it has to reject. Exits with 1 if anything printed ERROR.
+Build with: g++ -std=c++14 ProofDriver.cpp MerkleMountainRange.cpp SparseMerkleTree.cpp MerkleTree.cpp RBTree.cpp -lcryptopp -o ProofDriver*/
+
+int failures = 0;
+
+void report(const string& name, bool passed) {
+	if (passed) {
+		cout << name << " Verified Correctly" << endl;
+	}
+	else {
+		cout << "ERROR: " << name << endl;
+		failures++;
+	}
+}
+
+/*Digest of the i-th test message, random capital letters like MerkleDriver*/
+vector<byte> messageDigest(int i) {
+	SHA256 hash;
+	string message;
+	int length = 1 + rand() % 256;
+	for (int j = 0; j < length; j++) {
+		message += char(65 + rand() % 26);
+	}
+	message += to_string(i);//keeps every digest distinct
+	vector<byte> digest(CryptoPP::SHA256::DIGESTSIZE);
+	hash.CalculateDigest(digest.data(), (byte*)message.c_str(), message.length());
+	return digest;
+}
+
+bool sameHash(const byte a[], const byte b[]) {
+	for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+		if (a[i] != b[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*Two canonical trees fed the same leaves in opposite orders must agree on the root, and changing one leaf must change it*/
+void checkCanonical(const vector<vector<byte>>& digests) {
+	MerkleTree forwards(true);
+	MerkleTree backwards(true);
+	for (int i = 0; i < NUM_MESSAGES; i++) {
+		forwards.Insert(digests[i].data(), i * SCALING);
+		backwards.Insert(digests[NUM_MESSAGES - 1 - i].data(), (NUM_MESSAGES - 1 - i) * SCALING);
+	}
+
+	byte forwardsRoot[CryptoPP::SHA256::DIGESTSIZE];
+	byte backwardsRoot[CryptoPP::SHA256::DIGESTSIZE];
+	forwards.getRoot(forwardsRoot);
+	backwards.getRoot(backwardsRoot);
+	report("Canonical root", sameHash(forwardsRoot, backwardsRoot));
+	report("Canonical leaf", forwards.Verify(digests[7].data(), 7 * SCALING) && !forwards.Verify(digests[8].data(), 7 * SCALING));
+
+	backwards.Insert(digests[8].data(), 7 * SCALING);
+	backwards.getRoot(backwardsRoot);
+	report("Canonical tampered root", !sameHash(forwardsRoot, backwardsRoot));
+}
+
+/*Every leaf of a mountain range of every size up to NUM_MESSAGES has to prove its inclusion against the root at that size, and the same proof has
+to fail for a different digest, a flipped proof byte or the wrong leaf index*/
+void checkInclusion(const vector<vector<byte>>& digests) {
+	MerkleMountainRange log;
+	bool proved = true;
+	bool tamperedRejected = true;
+	byte root[CryptoPP::SHA256::DIGESTSIZE];
+	vector<byte> proof;
+
+	for (int size = 1; size <= NUM_MESSAGES; size++) {
+		log.Append(digests[size - 1].data());
+		log.getRoot(root);
+		for (int leaf = 0; leaf < size; leaf++) {
+			log.inclusionProof(leaf, proof);
+			if (!MerkleMountainRange::verifyInclusion(digests[leaf].data(), leaf, size, proof, root)) {
+				proved = false;
+			}
+			if (size == 1) {
+				continue;//a lone leaf has an empty proof and no other index to try
+			}
+			if (MerkleMountainRange::verifyInclusion(digests[(leaf + 1) % size].data(), leaf, size, proof, root)
+				|| MerkleMountainRange::verifyInclusion(digests[leaf].data(), (leaf + 1) % size, size, proof, root)) {
+				tamperedRejected = false;
+			}
+			proof[rand() % proof.size()] ^= 1;
+			if (MerkleMountainRange::verifyInclusion(digests[leaf].data(), leaf, size, proof, root)) {
+				tamperedRejected = false;
+			}
+		}
+	}
+
+	report("Mountain range inclusion", proved);
+	report("Mountain range tampered inclusion", tamperedRejected);
+}
+
+/*Every (old, new) pair of sizes up to NUM_MESSAGES has to prove consistent using only the two roots. A flipped proof byte has to fail, and so does
+a log that rewrote one early leaf, even though it has the right sizes and a well formed proof.*/
+void checkConsistency(const vector<vector<byte>>& digests) {
+	MerkleMountainRange log;
+	MerkleMountainRange rewritten;
+	for (int i = 0; i < NUM_MESSAGES; i++) {
+		log.Append(digests[i].data());
+		rewritten.Append(digests[i == 3 ? 4 : i].data());
+	}
+
+	vector<vector<byte>> roots(NUM_MESSAGES + 1, vector<byte>(CryptoPP::SHA256::DIGESTSIZE));
+	for (int size = 0; size <= NUM_MESSAGES; size++) {
+		log.getRoot(roots[size].data(), size);
+	}
+
+	bool proved = true;
+	bool tamperedRejected = true;
+	vector<byte> proof;
+	byte rewrittenRoot[CryptoPP::SHA256::DIGESTSIZE];
+	for (int oldSize = 0; oldSize <= NUM_MESSAGES; oldSize++) {
+		for (int newSize = oldSize; newSize <= NUM_MESSAGES; newSize++) {
+			log.consistencyProof(oldSize, newSize, proof);
+			if (!MerkleMountainRange::verifyConsistency(oldSize, newSize, roots[oldSize].data(), roots[newSize].data(), proof)) {
+				proved = false;
+			}
+			if (!proof.empty()) {
+				proof[rand() % proof.size()] ^= 1;
+				if (MerkleMountainRange::verifyConsistency(oldSize, newSize, roots[oldSize].data(), roots[newSize].data(), proof)) {
+					tamperedRejected = false;
+				}
+			}
+
+			if (oldSize > 3) {//leaf 3 is already in the old log, so the rewritten log is not an extension of it
+				rewritten.consistencyProof(oldSize, newSize, proof);
+				rewritten.getRoot(rewrittenRoot, newSize);
+				if (MerkleMountainRange::verifyConsistency(oldSize, newSize, roots[oldSize].data(), rewrittenRoot, proof)) {
+					tamperedRejected = false;
+				}
+			}
+		}
+	}
+
+	report("Mountain range consistency", proved);
+	report("Mountain range tampered consistency", tamperedRejected);
+
+	bool threw = false;
+	try {
+		log.getRoot(rewrittenRoot, NUM_MESSAGES + 1);
+	}
+	catch (const out_of_range&) {
+		threw = true;
+	}
+	report("Mountain range root past the end", threw);
+}
+
+/*A tiered mountain range with a cache much smaller than 2^pinnedHeight has to hand out exactly the same roots and proofs as the in memory one, at
+every size, so rebuilding evicted nodes from the leaf file can never change an answer*/
+void checkTiered(const vector<vector<byte>>& digests) {
+	const char* path = "ProofDriver.leaves";
+	bool matched = true;
+	bool tamperedRejected = true;
+	{
+		MerkleMountainRange memory;
+		MerkleMountainRange tiered(path, 3, 4);
+		byte memoryRoot[CryptoPP::SHA256::DIGESTSIZE];
+		byte tieredRoot[CryptoPP::SHA256::DIGESTSIZE];
+		vector<byte> memoryProof;
+		vector<byte> tieredProof;
+
+		for (int size = 1; size <= NUM_MESSAGES; size++) {
+			memory.Append(digests[size - 1].data());
+			tiered.Append(digests[size - 1].data());
+			memory.getRoot(memoryRoot);
+			tiered.getRoot(tieredRoot);
+			if (!sameHash(memoryRoot, tieredRoot)) {
+				matched = false;
+			}
+
+			for (int leaf = 0; leaf < size; leaf += 3) {
+				memory.inclusionProof(leaf, memoryProof);
+				tiered.inclusionProof(leaf, tieredProof);
+				if (memoryProof != tieredProof) {
+					matched = false;
+				}
+				memory.consistencyProof(leaf, size, memoryProof);
+				tiered.consistencyProof(leaf, size, tieredProof);
+				if (memoryProof != tieredProof) {
+					matched = false;
+				}
+				memory.getRoot(memoryRoot, leaf);
+				tiered.getRoot(tieredRoot, leaf);
+				if (!sameHash(memoryRoot, tieredRoot)) {
+					matched = false;
+				}
+			}
+		}
+
+		tiered.inclusionProof(NUM_MESSAGES / 2, tieredProof);
+		tiered.getRoot(tieredRoot);
+		tieredRoot[0] ^= 1;
+		tamperedRejected = !MerkleMountainRange::verifyInclusion(digests[NUM_MESSAGES / 2].data(), NUM_MESSAGES / 2, NUM_MESSAGES, tieredProof, tieredRoot);
+	}
+	remove(path);
+
+	report("Tiered mountain range", matched);
+	report("Tiered mountain range tampered root", tamperedRejected);
+}
+
+/*Every inserted key has to prove membership and every key in between has to prove absence against the same root. A flipped proof byte, the wrong
+digest, or a proof used for the opposite claim has to be rejected.*/
+void checkSparse(const vector<vector<byte>>& digests) {
+	SparseMerkleTree tree;
+	for (int i = 0; i < NUM_MESSAGES; i++) {
+		tree.Insert(digests[i].data(), i * SCALING);
+	}
+	byte root[CryptoPP::SHA256::DIGESTSIZE];
+	tree.getRoot(root);
+
+	bool proved = true;
+	bool tamperedRejected = true;
+	vector<byte> proof;
+	for (int i = 0; i < NUM_MESSAGES; i++) {
+		unsigned int key = i * SCALING;
+		tree.getProof(key, proof);
+		if (!SparseMerkleTree::verifyMembership(digests[i].data(), key, proof, root)) {
+			proved = false;
+		}
+		if (SparseMerkleTree::verifyNonMembership(key, proof, root)
+			|| SparseMerkleTree::verifyMembership(digests[(i + 1) % NUM_MESSAGES].data(), key, proof, root)) {
+			tamperedRejected = false;
+		}
+		proof[4 + rand() % (proof.size() - 4)] ^= 1;
+		if (SparseMerkleTree::verifyMembership(digests[i].data(), key, proof, root)) {
+			tamperedRejected = false;
+		}
+
+		unsigned int absent = key + 1 + rand() % (SCALING - 1);
+		tree.getProof(absent, proof);
+		if (!SparseMerkleTree::verifyNonMembership(absent, proof, root)) {
+			proved = false;
+		}
+		if (SparseMerkleTree::verifyMembership(digests[i].data(), absent, proof, root)) {
+			tamperedRejected = false;
+		}
+		proof[4 + rand() % (proof.size() - 4)] ^= 1;
+		if (SparseMerkleTree::verifyNonMembership(absent, proof, root)) {
+			tamperedRejected = false;
+		}
+	}
+
+	report("Sparse membership and non membership", proved);
+	report("Sparse tampered proofs", tamperedRejected);
+}
+
+/*InsertBatch has to leave the tree exactly as inserting one key at a time would, duplicate keys included (the later one wins), and a proof from the
+batched tree must not verify against a root that is missing the last batch*/
+void checkSparseBatch(const vector<vector<byte>>& digests) {
+	SparseMerkleTree sequential;
+	SparseMerkleTree batched;
+	byte before[CryptoPP::SHA256::DIGESTSIZE];
+	vector<unsigned int> keys;
+	vector<byte> batchDigests;
+
+	for (int i = 0; i < NUM_MESSAGES; i++) {
+		unsigned int key = (i % 10 == 9) ? keys.back() : (unsigned int)rand() * SCALING;//every tenth insert repeats a key in the same batch
+		sequential.Insert(digests[i].data(), key);
+		keys.push_back(key);
+		batchDigests.insert(batchDigests.end(), digests[i].begin(), digests[i].end());
+		if (keys.size() == 25 || i == NUM_MESSAGES - 1) {
+			batched.getRoot(before);
+			batched.InsertBatch(keys, batchDigests);
+			keys.clear();
+			batchDigests.clear();
+		}
+	}
+
+	byte sequentialRoot[CryptoPP::SHA256::DIGESTSIZE];
+	byte batchedRoot[CryptoPP::SHA256::DIGESTSIZE];
+	sequential.getRoot(sequentialRoot);
+	batched.getRoot(batchedRoot);
+	report("Sparse batch insert", sameHash(sequentialRoot, batchedRoot));
+
+	vector<byte> proof;
+	unsigned int key = (unsigned int)rand() * SCALING + 1;//not a multiple of SCALING so never inserted
+	batched.getProof(key, proof);
+	report("Sparse batch stale root", SparseMerkleTree::verifyNonMembership(key, proof, batchedRoot) && !SparseMerkleTree::verifyNonMembership(key, proof, before));
+}
+
+int main() {
+	srand((unsigned)time(0));
+
+	vector<vector<byte>> digests;
+	for (int i = 0; i < NUM_MESSAGES; i++) {
+		digests.push_back(messageDigest(i));
+	}
+
+	checkCanonical(digests);
+	checkInclusion(digests);
+	checkConsistency(digests);
+	checkTiered(digests);
+	checkSparse(digests);
+	checkSparseBatch(digests);
+
+	return failures == 0 ? 0 : 1;
+}
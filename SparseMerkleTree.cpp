@@ -0,0 +1,254 @@
+#include "SparseMerkleTree.h"
+
+using namespace std;
+
+/*Hash of an empty subtree for every height, starting from the empty leaf (all zero bytes, which no prefixed leaf hash will ever equal) and hashing
+it with itself on the way up. The root of an empty tree is hashes[SPARSE_DEPTH].*/
+struct EmptyHashTable {
+	byte hashes[SPARSE_DEPTH + 1][CryptoPP::SHA256::DIGESTSIZE];
+
+	EmptyHashTable() {
+		for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+			hashes[0][i] = 0;
+		}
+		for (int height = 0; height < SPARSE_DEPTH; height++) {
+			MerkleTree::hashNode(hashes[height + 1], hashes[height], hashes[height]);
+		}
+	}
+};
+
+SparseMerkleTree::SparseMerkleTree() {
+
+}
+
+/*Leaf hash for a present key. Like the canonical MerkleTree the key is hashed in with the digest, with the 0x00 leaf prefix.*/
+void SparseMerkleTree::leafHash(byte out[], const byte digest[], const unsigned int key) {
+	byte data[4 + CryptoPP::SHA256::DIGESTSIZE];
+	data[0] = (byte)(key >> 24);
+	data[1] = (byte)(key >> 16);
+	data[2] = (byte)(key >> 8);
+	data[3] = (byte)key;
+	for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+		data[4 + i] = digest[i];
+	}
+	MerkleTree::hashLeaf(out, data, sizeof(data));
+}
+
+/*Empty subtree hash for the given height, shared by every tree and by the static verifiers so it is only computed once*/
+const byte* SparseMerkleTree::emptyHash(int height) {
+	static const EmptyHashTable table;
+	return table.hashes[height];
+}
+
+/*Returns the stored hash for the node at the given height and index, or NULL if nothing has been inserted under it*/
+byte* SparseMerkleTree::findNode(int height, unsigned int index) {
+	auto node = nodes.find(((unsigned long long)height << 32) | index);
+	if (node == nodes.end()) {
+		return NULL;
+	}
+	return node->second;
+}
+
+/*Stores a hash for the node at the given height and index, reusing the old array if the node already had one*/
+void SparseMerkleTree::setNode(int height, unsigned int index, const byte hash[]) {
+	byte*& stored = nodes[((unsigned long long)height << 32) | index];
+	if (stored == NULL) {
+		stored = new byte[CryptoPP::SHA256::DIGESTSIZE];
+	}
+	for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+		stored[i] = hash[i];
+	}
+}
+
+/*Sets the leaf for key (replacing it if it already exists) and rehashes the SPARSE_DEPTH nodes above it. Siblings that were never written are
+taken from emptyHash, so an insert only ever adds the nodes on its own path.*/
+void SparseMerkleTree::Insert(const byte digest[], const unsigned int key) {
+	byte node[CryptoPP::SHA256::DIGESTSIZE];
+	leafHash(node, digest, key);
+	setNode(0, key, node);
+
+	unsigned int index = key;
+	for (int height = 0; height < SPARSE_DEPTH; height++) {
+		const byte* sibling = findNode(height, index ^ 1);
+		if (sibling == NULL) {
+			sibling = emptyHash(height);
+		}
+		if (index & 1) {
+			MerkleTree::hashNode(node, sibling, node);
+		}
+		else {
+			MerkleTree::hashNode(node, node, sibling);
+		}
+		index >>= 1;
+		setNode(height + 1, index, node);
+	}
+}
+
+/*Inserts many leaves at once, digests holding DIGESTSIZE bytes per key in the same order as keys (a later duplicate key wins, like calling Insert in
+order). All the leaves are written first, then the tree is rehashed one height at a time, so an ancestor shared by several of the keys is hashed once
+instead of once per key. Near the root every key shares the same path, which is where most of the saving is.*/
+void SparseMerkleTree::InsertBatch(const vector<unsigned int>& keys, const vector<byte>& digests) {
+	byte node[CryptoPP::SHA256::DIGESTSIZE];
+	for (size_t i = 0; i < keys.size(); i++) {
+		leafHash(node, &digests[i * CryptoPP::SHA256::DIGESTSIZE], keys[i]);
+		setNode(0, keys[i], node);
+	}
+
+	vector<unsigned int> dirty(keys);
+	sort(dirty.begin(), dirty.end());
+	dirty.erase(unique(dirty.begin(), dirty.end()), dirty.end());
+
+	for (int height = 0; height < SPARSE_DEPTH; height++) {
+		size_t parents = 0;
+		for (size_t i = 0; i < dirty.size(); i++) {
+			unsigned int parent = dirty[i] >> 1;
+			if (parents > 0 && dirty[parents - 1] == parent) {//the sibling was dirty too and has already rehashed this parent
+				continue;
+			}
+
+			const byte* left = findNode(height, parent << 1);
+			const byte* right = findNode(height, (parent << 1) | 1);
+			MerkleTree::hashNode(node, left != NULL ? left : emptyHash(height), right != NULL ? right : emptyHash(height));
+			setNode(height + 1, parent, node);
+			dirty[parents] = parent;
+			parents++;
+		}
+		dirty.resize(parents);
+	}
+}
+
+/*Checks that key is present with the given digest. Every stored node is rebuilt on Insert so comparing the leaf is enough here, use getProof for
+something a third party can check against the root.*/
+bool SparseMerkleTree::Verify(const byte digest[], const unsigned int key) {
+	byte* leaf = findNode(0, key);
+	if (leaf == NULL) {
+		return false;
+	}
+
+	byte expected[CryptoPP::SHA256::DIGESTSIZE];
+	leafHash(expected, digest, key);
+	for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+		if (leaf[i] != expected[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*Copies the root into out, which is the empty tree hash if nothing has been inserted*/
+void SparseMerkleTree::getRoot(byte out[]) {
+	const byte* root = findNode(SPARSE_DEPTH, 0);
+	if (root == NULL) {
+		root = emptyHash(SPARSE_DEPTH);
+	}
+	for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+		out[i] = root[i];
+	}
+}
+
+/*Fills proof with the siblings on the path from key to the root. The first 4 bytes are a bitmap with bit h set when the sibling at height h is
+not empty, followed by only those siblings from the bottom up. The same proof works for present and absent keys, with n keys in the tree it holds
+about log2(n) hashes instead of SPARSE_DEPTH.*/
+void SparseMerkleTree::getProof(const unsigned int key, vector<byte>& proof) {
+	proof.assign(4, 0);
+	unsigned int bitmap = 0;
+	unsigned int index = key;
+	for (int height = 0; height < SPARSE_DEPTH; height++) {
+		byte* sibling = findNode(height, index ^ 1);
+		if (sibling != NULL) {
+			bitmap |= 1u << height;
+			proof.insert(proof.end(), sibling, sibling + CryptoPP::SHA256::DIGESTSIZE);
+		}
+		index >>= 1;
+	}
+	proof[0] = (byte)(bitmap >> 24);
+	proof[1] = (byte)(bitmap >> 16);
+	proof[2] = (byte)(bitmap >> 8);
+	proof[3] = (byte)bitmap;
+}
+
+/*Rebuilds the root from a leaf hash and a proof from getProof. While every sibling so far has been empty the node on the path must be the empty
+subtree of that height too, so no hashing is done until the first real sibling, which is where the O(log n) cost of non membership proofs comes from.
+Only an empty leaf can take that shortcut, a present leaf is hashed all the way up. Returns false if the proof is malformed.*/
+bool SparseMerkleTree::rootFromProof(byte out[], const byte leaf[], const unsigned int key, const vector<byte>& proof) {
+	if (proof.size() < 4) {
+		return false;
+	}
+	unsigned int bitmap = ((unsigned int)proof[0] << 24) | ((unsigned int)proof[1] << 16) | ((unsigned int)proof[2] << 8) | proof[3];
+	size_t siblings = 0;
+	for (unsigned int i = bitmap; i != 0; i &= i - 1) {
+		siblings++;
+	}
+	if (proof.size() != 4 + siblings * CryptoPP::SHA256::DIGESTSIZE) {
+		return false;
+	}
+
+	bool empty = true;
+	for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+		out[i] = leaf[i];
+		if (leaf[i] != emptyHash(0)[i]) {
+			empty = false;
+		}
+	}
+
+	size_t next = 4;
+	unsigned int index = key;
+	for (int height = 0; height < SPARSE_DEPTH; height++) {
+		const byte* sibling = emptyHash(height);
+		if (bitmap & (1u << height)) {
+			sibling = &proof[next];
+			next += CryptoPP::SHA256::DIGESTSIZE;
+			empty = false;
+		}
+
+		if (empty) {//both children are empty so the parent is just the next empty hash
+			for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+				out[i] = emptyHash(height + 1)[i];
+			}
+		}
+		else if (index & 1) {
+			MerkleTree::hashNode(out, sibling, out);
+		}
+		else {
+			MerkleTree::hashNode(out, out, sibling);
+		}
+		index >>= 1;
+	}
+	return true;
+}
+
+/*Checks that key maps to digest in the tree with the given root, using only a proof from getProof*/
+bool SparseMerkleTree::verifyMembership(const byte digest[], const unsigned int key, const vector<byte>& proof, const byte root[]) {
+	byte leaf[CryptoPP::SHA256::DIGESTSIZE];
+	byte computed[CryptoPP::SHA256::DIGESTSIZE];
+	leafHash(leaf, digest, key);
+	if (!rootFromProof(computed, leaf, key, proof)) {
+		return false;
+	}
+	for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+		if (computed[i] != root[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*Checks that key is absent from the tree with the given root, meaning its leaf is the empty leaf, using only a proof from getProof*/
+bool SparseMerkleTree::verifyNonMembership(const unsigned int key, const vector<byte>& proof, const byte root[]) {
+	byte computed[CryptoPP::SHA256::DIGESTSIZE];
+	if (!rootFromProof(computed, emptyHash(0), key, proof)) {
+		return false;
+	}
+	for (int i = 0; i < CryptoPP::SHA256::DIGESTSIZE; i++) {
+		if (computed[i] != root[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+SparseMerkleTree::~SparseMerkleTree() {
+	for (auto i : nodes) {
+		delete[] i.second;
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "MerkleTree.h"
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+using namespace CryptoPP;
+
+#define SPARSE_DEPTH 32
+
+/*Merkle tree over every possible unsigned int key, where a key is its own path from the root (most significant bit first). Empty subtrees all hash
+to a known value per height, so only nodes with at least one leaf under them are stored, and proofs can leave out every empty sibling. That makes
+"this key is not present" as cheap to prove as "this key is present".*/
+class SparseMerkleTree{
+	private:
+		unordered_map<unsigned long long, byte*> nodes;//non empty nodes only, keyed by height in the high half and index at that height in the low half
+		static void leafHash(byte out[], const byte digest[], const unsigned int key);
+		static const byte* emptyHash(int height);
+		static bool rootFromProof(byte out[], const byte leaf[], const unsigned int key, const vector<byte>& proof);
+		byte* findNode(int height, unsigned int index);
+		void setNode(int height, unsigned int index, const byte hash[]);
+
+	public:
+		SparseMerkleTree();
+		~SparseMerkleTree();
+		void Insert(const byte digest[], const unsigned int key);
+		void InsertBatch(const vector<unsigned int>& keys, const vector<byte>& digests);
+		bool Verify(const byte digest[], const unsigned int key);
+		void getRoot(byte out[]);
+		void getProof(const unsigned int key, vector<byte>& proof);
+		static bool verifyMembership(const byte digest[], const unsigned int key, const vector<byte>& proof, const byte root[]);
+		static bool verifyNonMembership(const unsigned int key, const vector<byte>& proof, const byte root[]);
+};